@@ -1,9 +1,19 @@
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include <queue>
 #include <random>
+#include <set>
+#include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -15,12 +25,223 @@
 
 class None {};
 
+enum class TraceOp : uint8_t { NewHeap,
+                               Emplace,
+                               DecreaseKey,
+                               DeleteNode,
+                               Pop,
+                               Meld,
+                               Swap,
+                               Fork,
+                               Drop,
+                               Count };
+
+//operation trace file:
+//  header: "HHTR", sizeof(K) (1 byte)
+//  record: op (1 byte), heap id (4 bytes), then
+//    Emplace     : key, handle
+//    DecreaseKey : handle, key, new handle
+//    DeleteNode  : handle
+//    Meld, Swap  : other heap id
+//    Fork        : id of the new heap
+//    Drop        : nothing, the heap was destroyed (lets replay free it)
+//handles are the node indices seen by the recording process
+
+//identifies a heap within one recording session, it moves along with the heap object
+struct TraceId {
+  uint64_t session = 0;
+  uint32_t id = 0;
+};
+
+template <typename K>
+class TraceRecorder {
+  static_assert(std::is_trivially_copyable<K>::value, "keys are written as raw bytes");
+
+  std::ofstream out;
+  uint64_t session;
+  uint32_t countHeap;
+
+ public:
+  explicit TraceRecorder(const std::string &path) : out(path, std::ios::binary), session(nextSession()), countHeap(0) {
+    out.write("HHTR", 4);
+    put((uint8_t)sizeof(K));
+  }
+  bool good() const noexcept { return out.good(); }
+
+  void newHeap(TraceId &h) {
+    h = {session, countHeap++};
+    put(TraceOp::NewHeap);
+    put(h.id);
+  }
+  void emplace(TraceId &h, const K &k, int64_t u) {
+    op(TraceOp::Emplace, h);
+    put(k);
+    put((int32_t)u);
+  }
+  void decreaseKey(TraceId &h, int64_t u, const K &k, int64_t v) {
+    op(TraceOp::DecreaseKey, h);
+    put((int32_t)u);
+    put(k);
+    put((int32_t)v);
+  }
+  void deleteNode(TraceId &h, int64_t u) {
+    op(TraceOp::DeleteNode, h);
+    put((int32_t)u);
+  }
+  void pop(TraceId &h) { op(TraceOp::Pop, h); }
+  void meld(TraceId &h, TraceId &g) {
+    assert(knows(g));
+    op(TraceOp::Meld, h);
+    put(g.id);
+  }
+  void swap(TraceId &h, TraceId &g) {
+    assert(knows(g));
+    op(TraceOp::Swap, h);
+    put(g.id);
+  }
+  void fork(TraceId &h, TraceId &child) {
+    op(TraceOp::Fork, h);
+    child = {session, countHeap++};
+    put(child.id);
+  }
+  //heaps this session never saw (or moved-from ones) leave no record
+  void drop(TraceId &h) {
+    if (!knows(h)) return;
+    op(TraceOp::Drop, h);
+    h = TraceId();
+  }
+  //false for heaps created before this recorder, they must be announced (newHeap and an emplace
+  //per item they hold) before their first operation is recorded
+  bool knows(const TraceId &h) const noexcept { return h.session == session; }
+
+ private:
+  static uint64_t nextSession() {
+    static uint64_t countSession = 0;
+    return ++countSession;
+  }
+  template <typename T>
+  void put(const T &x) { out.write(reinterpret_cast<const char *>(&x), sizeof(T)); }
+  void op(TraceOp o, TraceId &h) {
+    assert(knows(h));
+    put(o);
+    put(h.id);
+  }
+};
+
+template <typename K>
+struct TraceRecord {
+  TraceOp op;
+  uint32_t heap, other;
+  int32_t handle, newHandle;
+  K key;
+};
+
+//rejects records on heaps that do not exist (yet or anymore), pops and deletions on empty heaps
+//and handles that were never issued to the heap since it was last empty (a fork inherits its
+//parent's handles, meld moves them). A handle whose item already left its heap is not detected
+template <typename K>
+bool checkTrace(const std::vector<TraceRecord<K>> &trace) {
+  std::vector<int64_t> size;  //-1: dropped
+  std::vector<std::unordered_set<int32_t>> issued;
+  auto alive = [&size](uint32_t h) { return h < size.size() && size[h] >= 0; };
+  for (const TraceRecord<K> &r : trace) {
+    if (r.op == TraceOp::NewHeap) {
+      if (r.heap != size.size()) return false;
+      size.push_back(0);
+      issued.emplace_back();
+      continue;
+    }
+    if (!alive(r.heap)) return false;
+    switch (r.op) {
+      case TraceOp::Emplace:
+        issued[r.heap].insert(r.handle);
+        ++size[r.heap];
+        break;
+      case TraceOp::DecreaseKey:
+        if (!issued[r.heap].count(r.handle)) return false;
+        issued[r.heap].insert(r.newHandle);
+        break;
+      case TraceOp::DeleteNode:
+        if (!issued[r.heap].count(r.handle)) return false;
+        //fallthrough
+      case TraceOp::Pop:
+        if (size[r.heap]-- == 0) return false;
+        if (size[r.heap] == 0) issued[r.heap].clear();
+        break;
+      case TraceOp::Meld:
+        if (!alive(r.other) || r.other == r.heap) return false;
+        size[r.heap] += size[r.other];
+        size[r.other] = 0;
+        issued[r.heap].insert(issued[r.other].begin(), issued[r.other].end());
+        issued[r.other].clear();
+        break;
+      case TraceOp::Swap:
+        if (!alive(r.other)) return false;
+        std::swap(size[r.heap], size[r.other]);
+        issued[r.heap].swap(issued[r.other]);
+        break;
+      case TraceOp::Fork:
+        if (r.other != size.size()) return false;
+        size.push_back(size[r.heap]);
+        issued.push_back(issued[r.heap]);
+        break;
+      case TraceOp::Drop:
+        size[r.heap] = -1;
+        issued[r.heap].clear();
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+template <typename K>
+bool loadTrace(const std::string &path, std::vector<TraceRecord<K>> &trace) {
+  std::ifstream in(path, std::ios::binary);
+  auto get = [&in](auto &x) { return (bool)in.read(reinterpret_cast<char *>(&x), sizeof(x)); };
+  char magic[4];
+  uint8_t keySize;
+  if (!get(magic) || std::string(magic, 4) != "HHTR") return false;
+  if (!get(keySize) || keySize != sizeof(K)) return false;
+  TraceRecord<K> r{};
+  while (get(r.op)) {
+    if (!get(r.heap)) return false;
+    bool ok = true;
+    switch (r.op) {
+      case TraceOp::NewHeap:
+      case TraceOp::Pop:
+      case TraceOp::Drop:
+        break;
+      case TraceOp::Emplace:
+        ok = get(r.key) && get(r.handle);
+        break;
+      case TraceOp::DecreaseKey:
+        ok = get(r.handle) && get(r.key) && get(r.newHandle);
+        break;
+      case TraceOp::DeleteNode:
+        ok = get(r.handle);
+        break;
+      case TraceOp::Meld:
+      case TraceOp::Swap:
+      case TraceOp::Fork:
+        ok = get(r.other);
+        break;
+      default:
+        ok = false;
+    }
+    if (!ok) return false;
+    trace.push_back(r);
+  }
+  return checkTrace(trace);
+}
+
 template <typename K, typename V = None, typename Compare = std::less<K>>
 class HollowHeap {
-  using Index = int_fast32_t;
+ public:
+  using Index = int_fast32_t;  //handle of an item, see emplace and decrease_key_handle
   using Counter = int_fast32_t;
 
- public:
   struct Node {
     K key;
     V value;
@@ -35,89 +256,296 @@ class HollowHeap {
   };
 
  private:
+  //copy-on-write overlay of a forked heap: nodes are addressed by logical index everywhere
+  //(links, handles) and a layer maps a logical index to the private copy of the node.
+  //A layer owns the copies and the nodes created through it, they are recycled when it dies
+  struct Layer {
+    std::unordered_map<Index, Index> slot;
+    std::shared_ptr<Layer> parent;  //frozen at fork(), shared with sibling branches
+    explicit Layer(std::shared_ptr<Layer> p) : parent(std::move(p)){};
+    ~Layer() {
+      for (const auto &e : slot) freeNodes.push_back(e.second);
+    }
+  };
+
   Counter countItem, countNode;
   Index root;
   std::vector<Index> rankArr;
+  std::shared_ptr<Layer> own;  //null unless this heap or one of its ancestors was forked
   static std::vector<Node> nodes;
+  static std::vector<Index> freeNodes;  //slots released by dead layers and deleted nodes of plain heaps
+  static std::vector<std::pair<Index, Index>> freeRanges;  //(base, length) released by bounded heaps, sorted
+
+  //bounded mode (capacity > 0): the heap owns the slots [base, base + 2 * capacity + 1) of nodes,
+  //recycles them through freeSlot (a list linked by next, -1 when empty) and rebuilds when they run
+  //out, so it never grows nodes.
+  //worstArr is a binary heap of handles ordered worst first, worstPos the position of each slot in it
+  Counter capacity;
+  Index base, freeSlot;
+  std::vector<Index> worstArr, worstPos;
+  TraceId trace;
+
+  struct ForkTag {};
+  HollowHeap(HollowHeap &p, std::shared_ptr<Layer> frozen, ForkTag) : countItem(p.countItem),
+                                                                                 countNode(p.countNode),
+                                                                                 root(p.root),
+                                                                                 rankArr(p.rankArr.size(), -1),
+                                                                                 own(std::make_shared<Layer>(std::move(frozen))),
+                                                                                 capacity(0),
+                                                                                 base(0),
+                                                                                 freeSlot(-1) {
+    if (recorder) recorder->fork(p.trace, trace);
+  };
 
  public:
-  HollowHeap() : countItem(0), countNode(0), root(-1), rankArr(3, -1){};
+  //opt-in: every mutating operation of every HollowHeap<K, V, Compare> is logged while set
+  static TraceRecorder<K> *recorder;
+
+  HollowHeap() : countItem(0), countNode(0), root(-1), rankArr(3, -1), capacity(0), base(0), freeSlot(-1) {
+    if (recorder) recorder->newHeap(trace);
+  };
+  //moving keeps the trace id, so the recorder still knows the heap
+  HollowHeap(HollowHeap &&g) noexcept : countItem(0), countNode(0), root(-1), rankArr(3, -1), capacity(0), base(0), freeSlot(-1) {
+    swap_(g);
+    std::swap(trace, g.trace);
+  }
+  HollowHeap &operator=(HollowHeap &&g) noexcept {
+    HollowHeap old(std::move(g));
+    swap_(old);
+    std::swap(trace, old.trace);
+    return *this;
+  }
+  ~HollowHeap() {
+    if (recorder) recorder->drop(trace);
+    if (capacity) free_range(base, (Index)worstPos.size());
+  }
+  //nodes are shared by all heaps of this type, a copy would alias them
+  HollowHeap(const HollowHeap &) = delete;
+  HollowHeap &operator=(const HollowHeap &) = delete;
+  //bounded heap holding at most cap items, all memory is allocated here.
+  //Its slots go back to freeRanges when it is destroyed and are reused by the next bounded heap
+  explicit HollowHeap(Counter cap) : countItem(0),
+                                     countNode(0),
+                                     root(-1),
+                                     rankArr(64, -1),
+                                     capacity(cap),
+                                     base(alloc_range(2 * cap + 1)),
+                                     freeSlot(-1),
+                                     worstPos(2 * cap + 1) {
+    assert(cap > 0);
+    for (Index i = (Index)worstPos.size() - 1; i >= 0; --i) free_slot(base + i);
+    worstArr.reserve(cap);
+    if (recorder) recorder->newHeap(trace);
+  };
   bool empty() const noexcept { return root == -1; }
   int size() const noexcept { return countItem; }
   Index push(K k) { return emplace(k, V()); }
   Index push(std::pair<K, V> &p) { emplace(p.first, p.second); }
   Index emplace(K k) { return emplace(k, V()); }
   Index emplace(K k, V v) {
-    ++countItem;
-    ++countNode;
-    nodes.emplace_back(k, v);
-    Index now = (Index)nodes.size() - 1;
-    root = meld_(now);
-    return now;
+    Index evicted;
+    return emplace(k, v, evicted);
+  }
+  //in bounded mode a full heap evicts its worst item for a better k and returns -1 (allocating nothing)
+  //for any other k. evicted is the handle of the evicted item, or -1
+  Index emplace(K k, V v, Index &evicted) {
+    evicted = -1;
+    if (full() && !Compare()(k, nodes[worstArr[0]].key)) return -1;  //kept small, most keys end here
+    return insert(k, std::move(v), evicted);
   }
   const K &top_key() {
     //do not use when the heap is empty
     //assert(countItem>0);
-    return nodes[root].key;
+    return own ? at<true>(root).key : nodes[root].key;
   }
-  const std::pair<K, V> &top() {
-    return make_pair(nodes[root].key, nodes[root].value);
+  std::pair<K, V> top() {
+    const Node &r = own ? at<true>(root) : nodes[root];
+    return std::make_pair(r.key, r.value);
   }
   Index pop() {
-    return delete_node(root);
+    if (recorder) {
+      announce();
+      recorder->pop(trace);
+    }
+    if (capacity) worst_erase(root);
+    return own ? delete_node_<true>(root) : delete_node_<false>(root);
+  }
+  bool full() const noexcept { return capacity && countItem == capacity; }
+  //bounded mode only, do not use when the heap is empty
+  Index worst() const noexcept {
+    assert(capacity && countItem);
+    return worstArr[0];
+  }
+  const K &worst_key() const {
+    assert(capacity && countItem);
+    return nodes[worstArr[0]].key;
+  }
+
+  //O(1): the returned heap shares every node with *this, both copy a node on their first write to it.
+  //Handles stay valid in both heaps. Memory per branch is one Layer plus the nodes it writes, freed
+  //with the branch; reads walk one hash lookup per live fork level above the node's last copy.
+  HollowHeap fork() {
+    assert(!capacity);  //a bounded heap does not share its slots
+    if (recorder) announce();
+    std::shared_ptr<Layer> frozen;
+    if (own) collapse();
+    if (own) frozen = own->slot.empty() ? own->parent : std::move(own);
+    own = std::make_shared<Layer>(frozen);
+    return HollowHeap(*this, std::move(frozen), ForkTag());
   }
 
   Index meld(HollowHeap &g) {
+    if (recorder) {
+      announce();
+      g.announce();
+      recorder->meld(trace, g.trace);
+    }
+    //a plain heap's nodes are private to it, so they read the same through any overlay
+    assert(!own || !g.own || g.root == -1);  //melding two forked heaps is not supported
+    assert(!capacity && !g.capacity);
+    if (!own) own = std::move(g.own);
+    if (rankArr.size() < g.rankArr.size()) rankArr.resize(g.rankArr.size(), -1);  //g's ranks may exceed ours
     countItem += g.countItem;
     countNode += g.countNode;
     g.countItem = g.countNode = 0;
-    root = meld_(g.root);
+    root = own ? meld_<true>(g.root) : meld_<false>(g.root);
     g.root = -1;
     return root;
   }
 
   //static Node* delete_node(){}
   Index delete_node(Index del) {
+    if (recorder) {
+      announce();
+      recorder->deleteNode(trace, del);
+    }
+    if (capacity) worst_erase(del);
+    return own ? delete_node_<true>(del) : delete_node_<false>(del);
+  }
+  Index decrease_key(Index u, K k) {
+    decrease_key_handle(u, k);
+    return root;
+  }
+  //same as decrease_key, but returns the handle that holds the item from now on
+  Index decrease_key_handle(Index u, K k) {
+    if (recorder) announce();
+    Index v = own ? decrease_key_<true>(u, k) : decrease_key_<false>(u, k);
+    if (recorder) recorder->decreaseKey(trace, u, k, v);
+    return v;
+  }
+  void swap(HollowHeap &a) {
+    if (recorder) {
+      announce();
+      a.announce();
+      recorder->swap(trace, a.trace);
+    }
+    swap_(a);
+  }
+
+ private:
+  //swaps the contents, each heap keeps its trace id
+  void swap_(HollowHeap &a) {
+    std::swap(countItem, a.countItem);
+    std::swap(countNode, a.countNode);
+    std::swap(root, a.root);
+    std::swap(rankArr, a.rankArr);
+    std::swap(own, a.own);
+    std::swap(capacity, a.capacity);
+    std::swap(base, a.base);
+    std::swap(freeSlot, a.freeSlot);
+    std::swap(worstArr, a.worstArr);
+    std::swap(worstPos, a.worstPos);
+  }
+  Index insert(K k, V v, Index &evicted) {
+    if (recorder) announce();
+    if (full()) {
+      evicted = worstArr[0];
+      delete_node(evicted);
+    }
+    if (capacity && freeSlot == -1) rebuild();
+    ++countItem;
+    ++countNode;
+    Index now = own ? emplace_<true>(k, v) : emplace_<false>(k, v);
+    if (capacity) worst_push(now);
+    if (recorder) recorder->emplace(trace, k, now);
+    return now;
+  }
+  //a heap created before the recorder was attached enters the trace as a new heap followed by
+  //one emplace per item, so replay starts from the same contents
+  void announce() {
+    if (recorder->knows(trace)) return;
+    recorder->newHeap(trace);
+    own ? announce_<true>() : announce_<false>();
+  }
+  template <bool Cow>
+  void announce_() {
+    std::vector<Index> stack;
+    if (root != -1) stack.push_back(root);
+    while (!stack.empty()) {
+      Index x = stack.back();
+      stack.pop_back();
+      for (Index w = at<Cow>(x).child; w != -1; w = at<Cow>(w).next) {
+        if (at<Cow>(w).secondParent == x) break;  //w is listed again under its first parent
+        stack.push_back(w);
+      }
+      if (at<Cow>(x).rank >= 0) recorder->emplace(trace, at<Cow>(x).key, x);
+    }
+  }
+
+  //the internals below are instantiated once for a plain heap (Cow = false, direct node access) and
+  //once for a forked one (Cow = true, through the layers); public operations pick one by own
+  template <bool Cow>
+  Index emplace_(K k, V v) {
+    Index now = new_node<Cow>(k, v);
+    root = meld_<Cow>(now);
+    return now;
+  }
+  template <bool Cow>
+  Index delete_node_(Index del) {
+    if (Cow) collapse();
     countItem--;
     countNode--;
-    nodes[del].rank = -1;
-    if (nodes[root].rank >= 0) return root;  //if del!=r_oot, deletion is completed
-    int maxRank = 0;
+    mut<Cow>(del).rank = -1;
+    if (at<Cow>(root).rank >= 0) return root;  //if del!=r_oot, deletion is completed
+    Index maxRank = 0;
     while (root != -1) {
-      Index w = nodes[root].child;
+      Index w = at<Cow>(root).child;
       Index x = root;
-      root = nodes[root].next;  //root lists all hollow roots
+      root = at<Cow>(root).next;  //root lists all hollow roots
       while (w != -1) {
         Index u = w;
-        w = nodes[w].next;
-        if (nodes[u].rank < 0) {              //if the child of root (u) is hollow node
-          if (nodes[u].secondParent == -1) {  //u became hollow by delete op
+        w = at<Cow>(w).next;
+        if (at<Cow>(u).rank < 0) {              //if the child of root (u) is hollow node
+          if (at<Cow>(u).secondParent == -1) {  //u became hollow by delete op
             //insert u to list of hollow nodes
-            nodes[u].next = root;
+            mut<Cow>(u).next = root;
             root = u;
           } else {  //u became hollow by decrease-key operation
-            if (nodes[u].secondParent == x)
+            if (at<Cow>(u).secondParent == x)
               w = -1;  //unnecessary?
             else
-              nodes[u].next = -1;        //when x is deleted, u is the last child of u->second_parent
-            nodes[u].secondParent = -1;  // u no longer have two parents
+              mut<Cow>(u).next = -1;        //when x is deleted, u is the last child of u->second_parent
+            mut<Cow>(u).secondParent = -1;  // u no longer have two parents
           }
-        } else {               //ranked link
-          nodes[u].next = -1;  //
-          while (rankArr[nodes[u].rank] != -1) {
-            u = link(u, rankArr[nodes[u].rank]);
-            rankArr[nodes[u].rank] = -1;
-            ++nodes[u].rank;
+        } else {                  //ranked link
+          mut<Cow>(u).next = -1;  //
+          while (rankArr[at<Cow>(u).rank] != -1) {
+            u = link<Cow>(u, rankArr[at<Cow>(u).rank]);
+            rankArr[at<Cow>(u).rank] = -1;
+            ++mut<Cow>(u).rank;
           }
-          rankArr[nodes[u].rank] = u;
-          maxRank = std::max(maxRank, nodes[u].rank);
+          rankArr[at<Cow>(u).rank] = u;
+          maxRank = std::max(maxRank, at<Cow>(u).rank);
           if (maxRank >= (int)rankArr.size() - 2) rankArr.resize((int)rankArr.size() * 2, -1);
         }
       }
       --countNode;
       if (x != -1) {
         //delete x;
-        //rebuild
+        if (capacity)
+          free_slot(x);
+        else if (!Cow)
+          freeNodes.push_back(x);  //a forked heap may share x, its layer recycles the copy
       }
     }
     //unranked link
@@ -126,51 +554,229 @@ class HollowHeap {
         if (root == -1)
           root = rankArr[i];
         else
-          root = link(root, rankArr[i]);
+          root = link<Cow>(root, rankArr[i]);
         rankArr[i] = -1;
       }
     }
+    if (Cow && root == -1) own.reset();  //nothing left to share, back to direct node access
     return root;
   }
   //static Node* decrease_key(){}//
   /*Node *decrease_key(HeapItem<K, V, Compare> &i, K k) {
     return decrease_key(i.node, k);
   }*/
-  Index decrease_key(Index u, K k) {
+  //returns the node holding the item after the operation
+  template <bool Cow>
+  Index decrease_key_(Index u, K k) {
+    if (capacity && freeSlot == -1) rebuild();  //before looking at root, rebuild moves it
     if (u == root) {
-      nodes[u].key = k;
+      mut<Cow>(u).key = k;
+      if (capacity) worst_down(worstPos[u - base]);
       return u;
     }
-    nodes.emplace_back(k, std::move(nodes[u].value));
-    Index v = (Index)nodes.size() - 1;
+    Index v = new_node<Cow>(k, std::move(mut<Cow>(u).value));
     countNode++;
-    nodes[u].rank = -1;
-    nodes[v].rank = std::max(0, nodes[u].rank - 2);
-    nodes[v].child = u;
-    nodes[u].secondParent = v;
-    return root = link(v, root);
+    mut<Cow>(u).rank = -1;
+    mut<Cow>(v).rank = std::max<Index>(0, at<Cow>(u).rank - 2);
+    mut<Cow>(v).child = u;
+    mut<Cow>(u).secondParent = v;
+    root = link<Cow>(v, root);
+    if (capacity) {
+      worstArr[worstPos[v - base] = worstPos[u - base]] = v;
+      worst_down(worstPos[v - base]);
+    }
+    return v;
   }
-  void swap(HollowHeap &a) {
-    std::swap(countItem, a.countItem);
-    std::swap(countNode, a.countNode);
-    std::swap(root, a.root);
-    std::swap(rankArr, a.rankArr);
+
+  //drops every hollow node and links the remaining ones into a single tree (unranked links).
+  //Runs when no slot is free, so every slot of the range holds a node and a scan finds them all
+  void rebuild() {
+    assert(freeSlot == -1);
+    root = -1;
+    for (Index u = base + (Index)worstPos.size() - 1; u >= base; --u) {
+      if (nodes[u].rank < 0) {
+        free_slot(u);
+        continue;
+      }
+      nodes[u].rank = 0;
+      nodes[u].child = nodes[u].next = nodes[u].secondParent = -1;
+      root = root == -1 ? u : link<false>(root, u);
+    }
+    countNode = countItem;
+  }
+  void free_slot(Index u) {
+    nodes[u].next = freeSlot;
+    freeSlot = u;
   }
 
- private:
+  //takes the smallest released range that fits (its rest stays free), or grows nodes by len slots,
+  //starting inside a released range at its end
+  static Index alloc_range(Index len) {
+    auto best = freeRanges.end();
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+      if (it->second >= len && (best == freeRanges.end() || it->second < best->second)) best = it;
+    if (best == freeRanges.end()) {
+      Index b = (Index)nodes.size();
+      if (!freeRanges.empty() && freeRanges.back().first + freeRanges.back().second == b) {
+        b = freeRanges.back().first;
+        freeRanges.pop_back();
+      }
+      nodes.resize(b + len, Node(K(), V()));
+      return b;
+    }
+    Index b = best->first;
+    if (best->second == len) {
+      freeRanges.erase(best);
+    } else {
+      best->first += len;
+      best->second -= len;
+    }
+    return b;
+  }
+  //merges [b, b + len) with its free neighbours
+  static void free_range(Index b, Index len) {
+    auto it = std::lower_bound(freeRanges.begin(), freeRanges.end(), std::make_pair(b, len));
+    if (it != freeRanges.end() && b + len == it->first) {
+      len += it->second;
+      it = freeRanges.erase(it);
+    }
+    if (it != freeRanges.begin() && std::prev(it)->first + std::prev(it)->second == b)
+      std::prev(it)->second += len;
+    else
+      freeRanges.emplace(it, b, len);
+  }
+
+  //worstArr: w is worse than u when Compare(u, w)
+  bool worse(Index w, Index u) const { return Compare()(nodes[u].key, nodes[w].key); }
+  void worst_set(Index i, Index u) {
+    worstArr[i] = u;
+    worstPos[u - base] = i;
+  }
+  void worst_up(Index i) {
+    Index u = worstArr[i];
+    for (; i > 0 && worse(u, worstArr[(i - 1) / 2]); i = (i - 1) / 2) worst_set(i, worstArr[(i - 1) / 2]);
+    worst_set(i, u);
+  }
+  void worst_down(Index i) {
+    Index u = worstArr[i], n = (Index)worstArr.size();
+    for (Index c; (c = 2 * i + 1) < n; i = c) {
+      if (c + 1 < n && worse(worstArr[c + 1], worstArr[c])) ++c;
+      if (!worse(worstArr[c], u)) break;
+      worst_set(i, worstArr[c]);
+    }
+    worst_set(i, u);
+  }
+  void worst_push(Index u) {
+    worstArr.push_back(u);
+    worst_up((Index)worstArr.size() - 1);
+  }
+  void worst_erase(Index u) {
+    Index i = worstPos[u - base], last = worstArr.back();
+    worstArr.pop_back();
+    if (last == u) return;
+    worst_set(i, last);
+    worst_up(i);
+    worst_down(worstPos[last - base]);
+  }
+
+  //node access: at() for reads, mut() for writes, which copies a node shared with another branch
+  template <bool Cow>
+  const Node &at(Index i) const {
+    if (!Cow) return nodes[i];
+    for (const Layer *l = own.get(); l; l = l->parent.get()) {
+      auto it = l->slot.find(i);
+      if (it != l->slot.end()) return nodes[it->second];
+    }
+    return nodes[i];
+  }
+  template <bool Cow>
+  Node &mut(Index i) {
+    if (!Cow) return nodes[i];
+    auto it = own->slot.find(i);
+    if (it != own->slot.end()) return nodes[it->second];
+    Index now;
+    if (freeNodes.empty()) {
+      nodes.push_back(at<Cow>(i));
+      now = (Index)nodes.size() - 1;
+    } else {
+      now = freeNodes.back();
+      freeNodes.pop_back();
+      nodes[now] = at<Cow>(i);
+    }
+    own->slot.emplace(i, now);
+    return nodes[now];
+  }
+  template <bool Cow>
+  Index new_node(K k, V v) {
+    Index now;
+    if (capacity) {
+      now = freeSlot;
+      freeSlot = nodes[now].next;
+      nodes[now] = Node(k, std::move(v));
+      return now;
+    }
+    if (freeNodes.empty()) {
+      nodes.emplace_back(k, std::move(v));
+      now = (Index)nodes.size() - 1;
+    } else {
+      now = freeNodes.back();
+      freeNodes.pop_back();
+      nodes[now] = Node(k, std::move(v));
+    }
+    if (Cow) own->slot.emplace(now, now);
+    return now;
+  }
+
+  //merges frozen layers no other heap can see anymore into own, so the chain only holds live forks.
+  //The smaller map is merged into the larger one
+  void collapse() {
+    while (own->parent && own->parent.use_count() == 1) {
+      std::shared_ptr<Layer> p = std::move(own->parent);
+      own->parent = std::move(p->parent);
+      std::unordered_map<Index, Index> &mine = own->slot, &older = p->slot;
+      if (mine.size() < older.size()) {
+        mine.swap(older);
+        for (const auto &e : older) {
+          auto r = mine.emplace(e);
+          if (!r.second) r.first->second = shadow(e.first, r.first->second, e.second);
+        }
+      } else {
+        for (const auto &e : older) {
+          auto r = mine.emplace(e);
+          if (!r.second) r.first->second = shadow(e.first, e.second, r.first->second);
+        }
+      }
+      older.clear();
+    }
+  }
+  //logical i was stored at p by the older layer and copied to q by the newer one: keeps the newer
+  //node and recycles the other slot. A node created at i keeps slot i, it may only be freed with i
+  Index shadow(Index i, Index p, Index q) {
+    if (p != i) {
+      freeNodes.push_back(p);
+      return q;
+    }
+    nodes[i] = nodes[q];
+    freeNodes.push_back(q);
+    return i;
+  }
+
+  template <bool Cow>
   void add_child(Index v, Index w) {  //make v child of w
-    nodes[v].next = nodes[w].child;
-    nodes[w].child = v;
+    mut<Cow>(v).next = at<Cow>(w).child;
+    mut<Cow>(w).child = v;
   }
+  template <bool Cow>
   Index link(Index v, Index w) {
-    if (Compare()(nodes[v].key, nodes[w].key)) {
-      add_child(w, v);
+    if (Compare()(at<Cow>(v).key, at<Cow>(w).key)) {
+      add_child<Cow>(w, v);
       return v;
     } else {
-      add_child(v, w);
+      add_child<Cow>(v, w);
       return w;
     }
   }
+  template <bool Cow>
   Index meld_(Index u) {
     if (u == -1) {
       //r_oot->item->uf->UFroot()->heap = this;
@@ -182,12 +788,18 @@ class HollowHeap {
     }
     //r_oot->item->uf->unite(u->item->uf);
     //r_oot->item->uf->UFroot()->heap = this;
-    return link(root, u);
+    return link<Cow>(root, u);
   }
   //rebuild
 };
 template <typename K, typename V, typename Compare>
 std::vector<typename HollowHeap<K, V, Compare>::Node> HollowHeap<K, V, Compare>::nodes;
+template <typename K, typename V, typename Compare>
+std::vector<typename HollowHeap<K, V, Compare>::Index> HollowHeap<K, V, Compare>::freeNodes;
+template <typename K, typename V, typename Compare>
+std::vector<std::pair<typename HollowHeap<K, V, Compare>::Index, typename HollowHeap<K, V, Compare>::Index>> HollowHeap<K, V, Compare>::freeRanges;
+template <typename K, typename V, typename Compare>
+TraceRecorder<K> *HollowHeap<K, V, Compare>::recorder = nullptr;
 
 void heapSort(int n) {
   std::random_device rnd;
@@ -224,9 +836,434 @@ void heapSort(int n) {
   std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(p1 - start).count() << std::endl;
   std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(p2 - p1).count() << std::endl;
 }
-int main() {
+//keeps the m smallest of n random keys, then pops them in order: bounded HollowHeap, a min and a max
+//HollowHeap linked by item id (what the bounded mode replaces), and a capped std::priority_queue
+void topN(int n, int m) {
+  std::mt19937 mt(1);
+  std::vector<int> a(n), b, c, d;
+  for (int i = 0; i < n; ++i) a[i] = (int)(mt() % (1u << 30));
+  std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+  HollowHeap<int> hh(m);
+  for (int i = 0; i < n; ++i) hh.emplace(a[i]);
+  for (; !hh.empty(); hh.pop()) b.push_back(hh.top_key());
+  std::chrono::system_clock::time_point p1 = std::chrono::system_clock::now();
+
+  HollowHeap<int, int> lo;
+  HollowHeap<int, int, std::greater<int>> hi;
+  std::vector<HollowHeap<int, int>::Index> loHandle(m), hiHandle(m);
+  std::vector<int> freeId(m);
+  for (int i = 0; i < m; ++i) freeId[i] = m - 1 - i;
+  for (int i = 0; i < n; ++i) {
+    int id;
+    if (lo.size() < m) {
+      id = freeId.back();
+      freeId.pop_back();
+    } else if (a[i] < hi.top_key()) {
+      id = hi.top().second;
+      hi.pop();
+      lo.delete_node(loHandle[id]);
+    } else {
+      continue;
+    }
+    loHandle[id] = lo.emplace(a[i], id);
+    hiHandle[id] = hi.emplace(a[i], id);
+  }
+  for (; !lo.empty(); lo.pop()) {
+    d.push_back(lo.top_key());
+    hi.delete_node(hiHandle[lo.top().second]);
+  }
+  assert(b == d);
+  std::chrono::system_clock::time_point p2 = std::chrono::system_clock::now();
+
+  std::priority_queue<int> pq;
+  for (int i = 0; i < n; ++i) {
+    if ((int)pq.size() < m) {
+      pq.push(a[i]);
+    } else if (a[i] < pq.top()) {
+      pq.pop();
+      pq.push(a[i]);
+    }
+  }
+  for (; !pq.empty(); pq.pop()) c.push_back(pq.top());
+  std::reverse(c.begin(), c.end());
+  assert(b == c);
+  std::chrono::system_clock::time_point p3 = std::chrono::system_clock::now();
+  std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(p1 - start).count() << std::endl;
+  std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(p2 - p1).count() << std::endl;
+  std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(p3 - p2).count() << std::endl;
+}
+
+//replay targets: a family of heaps addressed by trace heap id, handles are local to the target.
+//fork() is O(1) copy-on-write for HollowHeap and a deep copy for the baselines
+template <typename K>
+struct HollowHeaps {
+  using Handle = int_fast32_t;
+  std::deque<HollowHeap<K>> heaps;
+  void newHeap() { heaps.emplace_back(); }
+  void fork(uint32_t h) { heaps.push_back(heaps[h].fork()); }
+  void drop(uint32_t h) { heaps[h] = HollowHeap<K>(); }
+  Handle emplace(uint32_t h, K k) { return heaps[h].emplace(k); }
+  Handle decreaseKey(uint32_t h, Handle u, K k) { return heaps[h].decrease_key_handle(u, k); }
+  void deleteNode(uint32_t h, Handle u) { heaps[h].delete_node(u); }
+  K pop(uint32_t h) {
+    K k = heaps[h].top_key();
+    heaps[h].pop();
+    return k;
+  }
+  void meld(uint32_t h, uint32_t g) { heaps[h].meld(heaps[g]); }
+  void swap(uint32_t h, uint32_t g) { heaps[h].swap(heaps[g]); }
+};
+
+//the status quo fork() replaces: a branch is a new HollowHeap that re-emplaces every live item.
+//Handles are item ids kept as values, each heap maps its live ids to their node and key
+template <typename K>
+struct CopyHollowHeaps {
+  using Handle = int;
+  struct Heap {
+    HollowHeap<K, Handle> heap;
+    std::unordered_map<Handle, std::pair<typename HollowHeap<K, Handle>::Index, K>> item;
+  };
+  std::deque<Heap> heaps;
+  Handle countHandle = 0;
+  void newHeap() { heaps.emplace_back(); }
+  void fork(uint32_t h) {
+    heaps.emplace_back();
+    Heap &x = heaps[h], &c = heaps.back();
+    c.item.reserve(x.item.size());
+    for (const auto &e : x.item) c.item.emplace(e.first, std::make_pair(c.heap.emplace(e.second.second, e.first), e.second.second));
+  }
+  void drop(uint32_t h) { heaps[h] = Heap(); }
+  Handle emplace(uint32_t h, K k) {
+    heaps[h].item.emplace(countHandle, std::make_pair(heaps[h].heap.emplace(k, countHandle), k));
+    return countHandle++;
+  }
+  Handle decreaseKey(uint32_t h, Handle u, K k) {
+    Heap &x = heaps[h];
+    std::pair<typename HollowHeap<K, Handle>::Index, K> &i = x.item.at(u);
+    i = std::make_pair(x.heap.decrease_key_handle(i.first, k), k);
+    return u;
+  }
+  void deleteNode(uint32_t h, Handle u) {
+    Heap &x = heaps[h];
+    x.heap.delete_node(x.item.at(u).first);
+    x.item.erase(u);
+  }
+  K pop(uint32_t h) {
+    Heap &x = heaps[h];
+    std::pair<K, Handle> t = x.heap.top();
+    x.heap.pop();
+    x.item.erase(t.second);
+    return t.first;
+  }
+  void meld(uint32_t h, uint32_t g) {
+    Heap &x = heaps[h], &y = heaps[g];
+    x.heap.meld(y.heap);
+    if (x.item.size() < y.item.size()) x.item.swap(y.item);
+    x.item.insert(y.item.begin(), y.item.end());
+    y.item.clear();
+  }
+  void swap(uint32_t h, uint32_t g) {
+    heaps[h].heap.swap(heaps[g].heap);
+    heaps[h].item.swap(heaps[g].item);
+  }
+};
+
+//a handle's key never changes, decrease_key moves the item to a new handle, so forks can share keys
+template <typename K>
+struct SetHeaps {
+  using Handle = int;
+  std::vector<std::set<std::pair<K, Handle>>> heaps;
+  std::vector<K> keys;
+  void newHeap() { heaps.emplace_back(); }
+  void fork(uint32_t h) { heaps.push_back(heaps[h]); }
+  void drop(uint32_t h) { std::set<std::pair<K, Handle>>().swap(heaps[h]); }
+  Handle emplace(uint32_t h, K k) {
+    keys.push_back(k);
+    heaps[h].emplace(k, (Handle)keys.size() - 1);
+    return (Handle)keys.size() - 1;
+  }
+  Handle decreaseKey(uint32_t h, Handle u, K k) {
+    heaps[h].erase({keys[u], u});
+    return emplace(h, k);
+  }
+  void deleteNode(uint32_t h, Handle u) { heaps[h].erase({keys[u], u}); }
+  K pop(uint32_t h) {
+    K k = heaps[h].begin()->first;
+    heaps[h].erase(heaps[h].begin());
+    return k;
+  }
+  void meld(uint32_t h, uint32_t g) {
+    if (heaps[h].size() < heaps[g].size()) heaps[h].swap(heaps[g]);
+    heaps[h].insert(heaps[g].begin(), heaps[g].end());
+    heaps[g].clear();
+  }
+  void swap(uint32_t h, uint32_t g) { heaps[h].swap(heaps[g]); }
+};
+
+//std::priority_queue with lazy deletion: decrease_key and delete_node mark the handle dead in that heap,
+//every handle has one entry per heap, so a pruned entry also leaves the dead set
+template <typename K>
+struct LazyHeaps {
+  using Handle = int;
+  using Entry = std::pair<K, Handle>;
+  struct Heap {
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> pq;
+    std::unordered_set<Handle> dead;
+  };
+  std::vector<Heap> heaps;
+  Handle countHandle = 0;
+  void newHeap() { heaps.emplace_back(); }
+  void fork(uint32_t h) { heaps.push_back(heaps[h]); }
+  void drop(uint32_t h) { heaps[h] = Heap(); }
+  Handle emplace(uint32_t h, K k) {
+    heaps[h].pq.emplace(k, countHandle);
+    return countHandle++;
+  }
+  Handle decreaseKey(uint32_t h, Handle u, K k) {
+    deleteNode(h, u);
+    return emplace(h, k);
+  }
+  void deleteNode(uint32_t h, Handle u) { heaps[h].dead.insert(u); }
+  K pop(uint32_t h) {
+    prune(h);
+    K k = heaps[h].pq.top().first;
+    heaps[h].pq.pop();
+    return k;
+  }
+  void meld(uint32_t h, uint32_t g) {
+    if (heaps[h].pq.size() < heaps[g].pq.size()) std::swap(heaps[h], heaps[g]);
+    for (; !heaps[g].pq.empty(); heaps[g].pq.pop()) {
+      if (!heaps[g].dead.count(heaps[g].pq.top().second)) heaps[h].pq.push(heaps[g].pq.top());
+    }
+    heaps[g].dead.clear();
+  }
+  void swap(uint32_t h, uint32_t g) { std::swap(heaps[h], heaps[g]); }
+
+ private:
+  void prune(uint32_t h) {
+    Heap &x = heaps[h];
+    while (x.dead.erase(x.pq.top().second)) x.pq.pop();
+  }
+};
+
+struct OpStat {
+  long long count = 0, totalNs = 0, maxNs = 0;
+  void add(long long ns) {
+    ++count;
+    totalNs += ns;
+    maxNs = std::max(maxNs, ns);
+  }
+};
+
+//runs the trace against Heaps, prints per-op statistics and returns a checksum of the popped keys.
+//Recorded handles are mapped per heap: a fork shares its parent's handles, but decrease_key may
+//keep a recorded handle in one branch while the target moves the item to a new handle.
+//Entries remember when they were set: after a recorded handle is recycled, the newer entry is
+//the live one, and an empty heap has no live entries (a recorded heap shares nothing then)
+template <typename K, typename Heaps>
+uint64_t replay(const std::vector<TraceRecord<K>> &trace, const char *name) {
+  static const char *opName[] = {"new_heap", "emplace", "decrease_key", "delete_node", "pop", "meld", "swap", "fork", "drop"};
+  using HandleMap = std::unordered_map<int32_t, std::pair<typename Heaps::Handle, size_t>>;
+  Heaps hs;
+  std::vector<HandleMap> handle;
+  std::vector<int64_t> size;
+  OpStat stat[(int)TraceOp::Count];
+  uint64_t checksum = 0;
+  for (size_t t = 0; t < trace.size(); ++t) {
+    const TraceRecord<K> &r = trace[t];
+    typename Heaps::Handle u = 0, v = 0;
+    if (r.op == TraceOp::DecreaseKey || r.op == TraceOp::DeleteNode) u = handle[r.heap].at(r.handle).first;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    switch (r.op) {
+      case TraceOp::NewHeap:
+        hs.newHeap();
+        break;
+      case TraceOp::Emplace:
+        v = hs.emplace(r.heap, r.key);
+        break;
+      case TraceOp::DecreaseKey:
+        v = hs.decreaseKey(r.heap, u, r.key);
+        break;
+      case TraceOp::DeleteNode:
+        hs.deleteNode(r.heap, u);
+        break;
+      case TraceOp::Pop:
+        checksum = checksum * 1000003 + (uint64_t)hs.pop(r.heap);
+        break;
+      case TraceOp::Meld:
+        hs.meld(r.heap, r.other);
+        break;
+      case TraceOp::Swap:
+        hs.swap(r.heap, r.other);
+        break;
+      case TraceOp::Fork:
+        hs.fork(r.heap);
+        break;
+      case TraceOp::Drop:
+        hs.drop(r.heap);
+        break;
+      default:
+        break;
+    }
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    stat[(int)r.op].add(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+    //bookkeeping of the replay itself, outside the timed region
+    switch (r.op) {
+      case TraceOp::NewHeap:
+        handle.emplace_back();
+        size.push_back(0);
+        break;
+      case TraceOp::Emplace:
+        handle[r.heap][r.handle] = std::make_pair(v, t);
+        ++size[r.heap];
+        break;
+      case TraceOp::DecreaseKey:
+        handle[r.heap][r.newHandle] = std::make_pair(v, t);
+        break;
+      case TraceOp::DeleteNode:
+      case TraceOp::Pop:
+        if (--size[r.heap] == 0) HandleMap().swap(handle[r.heap]);
+        break;
+      case TraceOp::Meld:
+        for (const auto &e : handle[r.other]) {
+          auto it = handle[r.heap].insert(e).first;
+          if (it->second.second < e.second.second) it->second = e.second;
+        }
+        HandleMap().swap(handle[r.other]);
+        size[r.heap] += size[r.other];
+        size[r.other] = 0;
+        break;
+      case TraceOp::Swap:
+        handle[r.heap].swap(handle[r.other]);
+        std::swap(size[r.heap], size[r.other]);
+        break;
+      case TraceOp::Fork:
+        handle.push_back(handle[r.heap]);
+        size.push_back(size[r.heap]);
+        break;
+      case TraceOp::Drop:
+        HandleMap().swap(handle[r.heap]);
+        size[r.heap] = 0;
+        break;
+      default:
+        break;
+    }
+  }
+  std::cout << name << std::endl;
+  std::cout << std::setw(14) << "op" << std::setw(12) << "count" << std::setw(12) << "total[ms]"
+            << std::setw(10) << "Mops/s" << std::setw(10) << "mean[ns]" << std::setw(10) << "max[ns]" << std::endl;
+  for (int i = 0; i < (int)TraceOp::Count; ++i) {
+    if (stat[i].count == 0) continue;
+    std::cout << std::setw(14) << opName[i] << std::setw(12) << stat[i].count
+              << std::setw(12) << std::fixed << std::setprecision(3) << stat[i].totalNs / 1e6
+              << std::setw(10) << std::setprecision(2) << stat[i].count * 1e3 / std::max(1LL, stat[i].totalNs)
+              << std::setw(10) << std::setprecision(1) << (double)stat[i].totalNs / stat[i].count
+              << std::setw(10) << stat[i].maxNs << std::endl;
+  }
+  return checksum;
+}
+
+//replays the trace against every heap and checks that they popped the same keys
+int compareHeaps(const std::vector<TraceRecord<int>> &trace) {
+  uint64_t c0 = replay<int, HollowHeaps<int>>(trace, "HollowHeap");
+  uint64_t c1 = replay<int, CopyHollowHeaps<int>>(trace, "HollowHeap (fork re-emplaces every item)");
+  uint64_t c2 = replay<int, SetHeaps<int>>(trace, "std::set");
+  uint64_t c3 = replay<int, LazyHeaps<int>>(trace, "std::priority_queue (lazy deletion)");
+  if (c0 != c1 || c0 != c2 || c0 != c3) {
+    std::cerr << "popped keys differ between heaps" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int replayTrace(const std::string &path) {
+  std::vector<TraceRecord<int>> trace;
+  if (!loadTrace(path, trace)) {
+    std::cerr << "cannot read trace: " << path << std::endl;
+    return 1;
+  }
+  return compareHeaps(trace);
+}
+
+//synthetic branch-and-bound trace: every search node pops its best few items, pushes a new best
+//one and forks the frontier into two branches, each adding, improving and dropping a few items
+//before recursing. The first branch improves the new best item, which is its root, so the handle
+//stays the same, and the second branch deletes that handle
+struct BranchTrace {
+  std::mt19937 mt;
+  std::vector<TraceRecord<int>> trace;
+  uint32_t countHeap = 0;
+  int32_t countHandle = 0;
+  int low = 0;  //keys below every random key, decreasing
+
+  BranchTrace(int n, int depth) : mt(1) {
+    add(TraceOp::NewHeap, countHeap++);
+    for (int i = 0; i < n; ++i) emplace(0, (int)(mt() % (1u << 30)));
+    search(0, n, depth);
+  }
+
+ private:
+  void add(TraceOp op, uint32_t heap, uint32_t other = 0, int32_t handle = 0, int32_t newHandle = 0, int key = 0) {
+    trace.push_back({op, heap, other, handle, newHandle, key});
+  }
+  int32_t emplace(uint32_t h, int k) {
+    add(TraceOp::Emplace, h, 0, countHandle, 0, k);
+    return countHandle++;
+  }
+  void search(uint32_t h, int size, int depth) {
+    for (int i = 0; i < 4 && size > 0; ++i, --size) add(TraceOp::Pop, h);
+    if (depth == 0) return;
+    int32_t best = emplace(h, --low);
+    for (int b = 0; b < 2; ++b) {
+      uint32_t c = countHeap++;
+      add(TraceOp::Fork, h, c);
+      if (b == 0)
+        add(TraceOp::DecreaseKey, c, 0, best, best, --low);
+      else
+        add(TraceOp::DeleteNode, c, 0, best);
+      int32_t added[8];
+      int keys[8];
+      for (int i = 0; i < 8; ++i) added[i] = emplace(c, keys[i] = (int)(mt() % (1u << 30)));
+      for (int i = 0; i < 2; ++i) add(TraceOp::DecreaseKey, c, 0, added[i], countHandle++, keys[i] / 2);
+      add(TraceOp::DeleteNode, c, 0, added[7]);
+      search(c, size + 8 - b, depth - 1);
+      add(TraceOp::Drop, c);
+    }
+  }
+};
+
+//usage: a.out               read n, run heapSort(n)
+//       a.out record FILE   same, logging the HollowHeap operations to FILE
+//       a.out replay FILE   replay FILE against HollowHeap and the baseline heaps
+//       a.out branch        read n, replay a fork-heavy search over a frontier of n items
+//       a.out topn          read n m, keep the m smallest of n keys in a bounded heap
+int main(int argc, char **argv) {
+  std::string mode = argc >= 2 ? argv[1] : "";
+  if (mode == "replay" && argc >= 3) return replayTrace(argv[2]);
+  if (mode == "topn") {
+    long long n = 0, m = 0;
+    std::cin >> n >> m;
+    topN((int)n, (int)m);
+    return 0;
+  }
+  if (mode == "branch") {
+    long long n = 0;
+    std::cin >> n;
+    return compareHeaps(BranchTrace((int)n, 12).trace);
+  }
+  if (mode != "record" || argc < 3) mode.clear();
+  std::unique_ptr<TraceRecorder<int>> rec;
+  if (mode == "record") {
+    rec.reset(new TraceRecorder<int>(argv[2]));
+    if (!rec->good()) {
+      std::cerr << "cannot open trace: " << argv[2] << std::endl;
+      return 1;
+    }
+    HollowHeap<int>::recorder = rec.get();
+  }
   long long n = 0;
   std::cin >> n;
   heapSort(n);
+  HollowHeap<int>::recorder = nullptr;
   return 0;
 }